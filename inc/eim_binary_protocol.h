@@ -0,0 +1,85 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _EIM_BINARY_PROTOCOL_H_
+#define _EIM_BINARY_PROTOCOL_H_
+
+#include <stdint.h>
+
+/**
+ * Length-prefixed binary framing for the .eim runner. A client opts in by sending
+ * {"id": 1, "hello": 1, "protocol": "binary"}; the hello response is still a JSON message,
+ * every message after that (in both directions) is a fixed header followed by `payload_length`
+ * bytes. All fields are little-endian.
+ *
+ * Requests:
+ *   EIM_BINARY_MSG_JSON                - payload is a regular JSON message (e.g. set_threshold)
+ *   EIM_BINARY_MSG_CLASSIFY            - payload is the raw input tensor (input_features_count elements)
+ *   EIM_BINARY_MSG_CLASSIFY_CONTINUOUS - payload is one raw slice (slice_size elements)
+ *
+ * Responses use the same header, with message_type set to EIM_BINARY_MSG_RESPONSE, the id of
+ * the request, and a JSON payload (the same object as in the JSON protocol, without separators).
+ */
+
+#define EIM_BINARY_MAGIC                0x424d4945 // "EIMB"
+#define EIM_BINARY_PROTOCOL_VERSION     1
+
+typedef enum {
+    EIM_BINARY_MSG_JSON = 1,
+    EIM_BINARY_MSG_CLASSIFY = 2,
+    EIM_BINARY_MSG_CLASSIFY_CONTINUOUS = 3,
+    EIM_BINARY_MSG_RESPONSE = 0x80,
+} eim_binary_message_type_t;
+
+typedef enum {
+    EIM_BINARY_DTYPE_NONE = 0,
+    EIM_BINARY_DTYPE_FLOAT32 = 1,
+} eim_binary_dtype_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t id;
+    uint16_t message_type;
+    uint8_t dtype;
+    uint8_t flags;
+    uint32_t payload_length;
+} eim_binary_header_t;
+
+static_assert(sizeof(eim_binary_header_t) == 16, "eim_binary_header_t should be 16 bytes");
+
+// set in `flags` to enable debug output for a classify request
+#define EIM_BINARY_FLAG_DEBUG           0x01
+
+#endif // _EIM_BINARY_PROTOCOL_H_
@@ -0,0 +1,152 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _EIM_SHM_QUEUE_H_
+#define _EIM_SHM_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Shared memory command queue for the .eim runner (Linux only). The segment is created on 'hello'
+ * and advertised as 'shm_command_queue'. It holds two single-producer / single-consumer rings:
+ *
+ *   requests  - written by the client, read by the runner (classify the input in shm slot N)
+ *   responses - written by the runner, read by the client (status, timing and scores)
+ *
+ * Head / tail counters only ever increase (wrapping at 2^32), entry = counter % capacity. A side
+ * that finds its ring empty sets its *_waiting flag, re-checks, and then sleeps in futex_wait on the
+ * head counter; the producer wakes it after publishing if the flag is set. As long as the other side
+ * keeps up, no syscalls are made at all.
+ *
+ * Layout (offsets in bytes from the start of the segment):
+ *   0                 eim_shm_queue_header_t
+ *   request_offset    request_capacity x eim_shm_queue_request_t
+ *   response_offset   response_capacity x response_entry_size
+ *                     (eim_shm_queue_response_t followed by value_count floats)
+ */
+
+#define EIM_SHM_QUEUE_MAGIC             0x51454945 // "EIEQ"
+#define EIM_SHM_QUEUE_VERSION           1
+
+typedef enum {
+    EIM_SHM_QUEUE_CLASSIFY = 1,
+    EIM_SHM_QUEUE_CLASSIFY_CONTINUOUS = 2,
+} eim_shm_queue_request_type_t;
+
+// set in `flags` to enable debug output for a request
+#define EIM_SHM_QUEUE_FLAG_DEBUG        0x01
+
+typedef struct {
+    uint32_t id;
+    uint16_t slot;
+    uint16_t type;
+    uint32_t flags;
+    uint32_t reserved;
+} eim_shm_queue_request_t;
+
+typedef struct {
+    uint32_t id;
+    uint16_t slot;
+    int16_t error;                  // EI_IMPULSE_ERROR, 0 = OK
+    uint32_t dsp_us;
+    uint32_t classification_us;
+    uint32_t anomaly_us;
+    float anomaly;
+    uint32_t value_count;           // classification scores that follow (in label order)
+    uint32_t reserved;
+} eim_shm_queue_response_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t request_capacity;
+    uint32_t response_capacity;
+    uint32_t request_offset;
+    uint32_t response_offset;
+    uint32_t response_entry_size;
+    uint32_t reserved0;
+
+    // every counter on its own cache line, so producer and consumer don't share lines
+    alignas(64) uint32_t request_head;      // written by the client
+    alignas(64) uint32_t request_tail;      // written by the runner
+    alignas(64) uint32_t response_head;     // written by the runner
+    alignas(64) uint32_t response_tail;     // written by the client
+    alignas(64) uint32_t runner_waiting;    // runner sleeps on request_head
+    alignas(64) uint32_t client_waiting;    // client sleeps on response_head
+} eim_shm_queue_header_t;
+
+static inline uint32_t eim_shm_queue_load(const uint32_t *ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void eim_shm_queue_store(uint32_t *ptr, uint32_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+#if defined(__linux__)
+// not FUTEX_PRIVATE_FLAG, the waiter and the waker live in different processes
+static inline int eim_futex_wait(uint32_t *addr, uint32_t expected, const struct timespec *timeout) {
+    return syscall(SYS_futex, addr, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static inline int eim_futex_wake(uint32_t *addr) {
+    return syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+#endif // __linux__
+
+static inline eim_shm_queue_request_t *eim_shm_queue_request_at(eim_shm_queue_header_t *q, uint32_t counter) {
+    return (eim_shm_queue_request_t *)((uint8_t *)q + q->request_offset) + (counter % q->request_capacity);
+}
+
+static inline eim_shm_queue_response_t *eim_shm_queue_response_at(eim_shm_queue_header_t *q, uint32_t counter) {
+    return (eim_shm_queue_response_t *)((uint8_t *)q + q->response_offset +
+        (size_t)(counter % q->response_capacity) * q->response_entry_size);
+}
+
+static inline size_t eim_shm_queue_size_bytes(uint32_t request_capacity, uint32_t response_capacity, uint32_t value_count) {
+    size_t response_entry_size = sizeof(eim_shm_queue_response_t) + value_count * sizeof(float);
+    return sizeof(eim_shm_queue_header_t) +
+        request_capacity * sizeof(eim_shm_queue_request_t) +
+        response_capacity * response_entry_size;
+}
+
+#endif // _EIM_SHM_QUEUE_H_
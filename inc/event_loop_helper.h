@@ -0,0 +1,177 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _EVENT_LOOP_HELPER_H_
+#define _EVENT_LOOP_HELPER_H_
+
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+/**
+ * Minimal readiness loop over a set of file descriptors. Uses epoll on Linux, and falls back
+ * to poll() on other POSIX systems (e.g. macOS) so the runner builds everywhere.
+ */
+typedef struct {
+    int fd;
+    bool readable;
+    bool writable;
+    bool hangup;
+} event_loop_event_t;
+
+typedef struct {
+#if defined(__linux__)
+    int epoll_fd;
+#else
+    std::vector<struct pollfd> fds;
+#endif
+} event_loop_t;
+
+static inline int event_loop_init(event_loop_t *loop) {
+#if defined(__linux__)
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return loop->epoll_fd < 0 ? -1 : 0;
+#else
+    loop->fds.clear();
+    return 0;
+#endif
+}
+
+static inline void event_loop_deinit(event_loop_t *loop) {
+#if defined(__linux__)
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+#else
+    loop->fds.clear();
+#endif
+}
+
+static inline int event_loop_add(event_loop_t *loop, int fd, bool want_read, bool want_write) {
+#if defined(__linux__)
+    struct epoll_event ev = { 0 };
+    ev.events = (want_read ? EPOLLIN : 0) | (want_write ? EPOLLOUT : 0) | EPOLLRDHUP;
+    ev.data.fd = fd;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+#else
+    struct pollfd pfd = { 0 };
+    pfd.fd = fd;
+    pfd.events = (want_read ? POLLIN : 0) | (want_write ? POLLOUT : 0);
+    loop->fds.push_back(pfd);
+    return 0;
+#endif
+}
+
+static inline int event_loop_modify(event_loop_t *loop, int fd, bool want_read, bool want_write) {
+#if defined(__linux__)
+    struct epoll_event ev = { 0 };
+    ev.events = (want_read ? EPOLLIN : 0) | (want_write ? EPOLLOUT : 0) | EPOLLRDHUP;
+    ev.data.fd = fd;
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+#else
+    for (auto& pfd : loop->fds) {
+        if (pfd.fd == fd) {
+            pfd.events = (want_read ? POLLIN : 0) | (want_write ? POLLOUT : 0);
+            return 0;
+        }
+    }
+    errno = ENOENT;
+    return -1;
+#endif
+}
+
+static inline int event_loop_remove(event_loop_t *loop, int fd) {
+#if defined(__linux__)
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    for (auto it = loop->fds.begin(); it != loop->fds.end(); ++it) {
+        if (it->fd == fd) {
+            loop->fds.erase(it);
+            return 0;
+        }
+    }
+    errno = ENOENT;
+    return -1;
+#endif
+}
+
+/**
+ * Wait for events (timeout_ms = -1 to block). Returns the number of events written to `events`,
+ * 0 on timeout, or -1 on error (EINTR is reported as 0 events).
+ */
+static inline int event_loop_wait(event_loop_t *loop, event_loop_event_t *events, int max_events, int timeout_ms) {
+#if defined(__linux__)
+    struct epoll_event ep_events[64];
+    if (max_events > 64) {
+        max_events = 64;
+    }
+    int n = epoll_wait(loop->epoll_fd, ep_events, max_events, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int ix = 0; ix < n; ix++) {
+        events[ix].fd = ep_events[ix].data.fd;
+        events[ix].readable = ep_events[ix].events & EPOLLIN;
+        events[ix].writable = ep_events[ix].events & EPOLLOUT;
+        events[ix].hangup = ep_events[ix].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP);
+    }
+    return n;
+#else
+    int n = poll(loop->fds.data(), loop->fds.size(), timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    int count = 0;
+    for (auto& pfd : loop->fds) {
+        if (count >= max_events) break;
+        if (pfd.revents == 0) continue;
+        events[count].fd = pfd.fd;
+        events[count].readable = pfd.revents & POLLIN;
+        events[count].writable = pfd.revents & POLLOUT;
+        events[count].hangup = pfd.revents & (POLLHUP | POLLERR);
+        count++;
+    }
+    return count;
+#endif
+}
+
+#endif // _EVENT_LOOP_HELPER_H_
@@ -0,0 +1,135 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _RESPONSE_WRITER_HELPER_H_
+#define _RESPONSE_WRITER_HELPER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+
+/**
+ * rapidjson output stream that writes straight into a fixed, caller owned, buffer. Writing past
+ * the end is not an error here (the bytes are dropped), check overflowed() when done.
+ */
+class ResponseBufferStream {
+public:
+    typedef char Ch;
+
+    ResponseBufferStream() : buffer_(nullptr), size_(0), ix_(0) { }
+
+    void Reset(char *buffer, size_t size) {
+        buffer_ = buffer;
+        size_ = size;
+        ix_ = 0;
+    }
+
+    void Put(Ch c) {
+        if (ix_ < size_) {
+            buffer_[ix_] = c;
+        }
+        ix_++;
+    }
+
+    void Write(const char *data, size_t len) {
+        if (ix_ + len <= size_) {
+            memcpy(buffer_ + ix_, data, len);
+        }
+        ix_ += len;
+    }
+
+    void Flush() { }
+
+    size_t length() const { return ix_; }
+    bool overflowed() const { return ix_ > size_; }
+
+private:
+    char *buffer_;
+    size_t size_;
+    size_t ix_;
+};
+
+typedef rapidjson::Writer<ResponseBufferStream> ResponseWriter;
+
+/**
+ * Format a float with the least number of digits that still parses back to the same float
+ * (so 0.1f is written as 0.1, not as 0.10000000149011612). Returns the number of characters.
+ */
+static inline size_t format_float_shortest(float value, char *out, size_t out_size) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto res = std::to_chars(out, out + out_size, value);
+    return res.ec == std::errc() ? (size_t)(res.ptr - out) : 0;
+#else
+    // no floating point to_chars (GCC < 11), find the shortest precision that round-trips
+    int len = 0;
+    for (int precision = 6; precision <= 9; precision++) {
+        len = snprintf(out, out_size, "%.*g", precision, value);
+        if (strtof(out, nullptr) == value) {
+            break;
+        }
+    }
+    return len > 0 ? (size_t)len : 0;
+#endif
+}
+
+static inline void write_float(ResponseWriter &writer, float value) {
+    // JSON has no NaN / Infinity
+    if (!isfinite(value)) {
+        writer.Null();
+        return;
+    }
+    char buf[32];
+    size_t len = format_float_shortest(value, buf, sizeof(buf));
+    writer.RawValue(buf, len, rapidjson::kNumberType);
+}
+
+/**
+ * JSON-escape a string once (including the quotes), so it can be written many times
+ * with writer.RawValue(..., rapidjson::kStringType).
+ */
+static inline std::string json_escape_string(const char *str) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.String(str);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+#endif // _RESPONSE_WRITER_HELPER_H_
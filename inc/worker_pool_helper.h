@@ -0,0 +1,144 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _WORKER_POOL_HELPER_H_
+#define _WORKER_POOL_HELPER_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+/**
+ * Fixed-size pool of worker threads that execute tasks from a FIFO queue. Every task gets the
+ * index of the worker that runs it, so callers can keep per-worker state (e.g. one classifier
+ * instance per worker) without any locking.
+ */
+class WorkerPool {
+public:
+    typedef std::function<void(size_t worker_ix)> task_t;
+
+    WorkerPool(size_t thread_count) : stopping_(false) {
+        if (thread_count == 0) {
+            thread_count = 1;
+        }
+        for (size_t ix = 0; ix < thread_count; ix++) {
+            threads_.emplace_back(&WorkerPool::run, this, ix);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_) {
+            t.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(task_t task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    size_t size() const {
+        return threads_.size();
+    }
+
+    size_t queue_depth() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+private:
+    void run(size_t worker_ix) {
+        while (1) {
+            task_t task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (stopping_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task(worker_ix);
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::deque<task_t> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+};
+
+/**
+ * Wait until `count` tasks have called count_down()
+ */
+class CountDownLatch {
+public:
+    CountDownLatch(size_t count) : count_(count) { }
+
+    void count_down() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ > 0 && --count_ == 0) {
+            cv_.notify_all();
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return count_ == 0; });
+    }
+
+private:
+    size_t count_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+#endif // _WORKER_POOL_HELPER_H_
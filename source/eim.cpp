@@ -38,9 +38,12 @@
 #include <cstring>
 #include <iostream>
 #include <sstream>
-// #include <thread>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include <chrono>
 #include <vector>
+#include <map>
 #include <signal.h>
 #include "edge-impulse-sdk/classifier/ei_run_classifier.h"
 #include "json/json.hpp"
@@ -53,6 +56,16 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#include "inc/event_loop_helper.h"
+#include "inc/eim_binary_protocol.h"
+#include "inc/response_writer_helper.h"
+#include "inc/worker_pool_helper.h"
+#include "inc/eim_shm_queue.h"
 
 using namespace std;
 
@@ -74,9 +87,16 @@ extern std::stringstream engine_info;
 std::stringstream engine_info;
 #endif
 
+typedef enum {
+    PROTOCOL_JSON = 0,
+    PROTOCOL_BINARY = 1,
+} runner_protocol_t;
+
+// per-client state (one for stdin, one per socket connection)
 typedef struct {
     bool initialized;
     int version;
+    runner_protocol_t protocol;
 } runner_state_t;
 
 #if defined __GNUC__
@@ -87,18 +107,51 @@ typedef struct {
 #define ALIGN(X) __align(X)
 #endif
 
+// command line options (see main())
+typedef struct {
+    size_t worker_threads;      // --threads, 0 = one per core
+    size_t max_batch_size;      // --max-batch-size, size of the batch shm input (in frames)
+    size_t shm_slots;           // --shm-slots, number of shm input (and freeform output) slots
+    size_t shm_queue_size;      // --shm-queue-size, entries in the shm command queue (0 = disabled)
+} runner_options_t;
+
+static runner_options_t options = { 0, 16, 1, 16 };
+
+// one instance of the impulse, with its own state and (freeform) output buffers
+typedef struct {
+    ei_impulse_handle_t *handle;
+    std::vector<matrix_t> freeform_outputs;
+} classifier_instance_t;
+
+// used for all single (non-batched) requests; both the client messages and the shm command queue
+// use it, so it's guarded by default_classifier_mutex
+static classifier_instance_t default_classifier = { &ei_default_impulse, { } };
+static std::mutex default_classifier_mutex;
+
 #if EI_CLASSIFIER_FREEFORM_OUTPUT
-static std::vector<matrix_t> freeform_outputs;
+// freeform outputs backed by the shm output tensors, one set per slot (slot 0 is also used for non-shm requests)
+static std::vector<std::vector<matrix_t>> freeform_output_slots;
 #endif
 
+// batches are spread over a pool of workers, each with their own classifier instance (created on first use)
+static WorkerPool *classifier_pool = nullptr;
+static std::vector<classifier_instance_t *> pool_classifiers;
+
 static char rapidjson_buffer[10 * 1024 * 1024] ALIGN(8);
 rapidjson::MemoryPoolAllocator<> rapidjson_allocator(rapidjson_buffer, sizeof(rapidjson_buffer));
 
-static runner_state_t state = { 0 };
+static runner_state_t stdin_state = { 0 };
+
+// the impulse (and the shm tensors) are shared between all clients, and are set up on the first 'hello'
+static bool impulse_initialized = false;
+static const size_t shm_features_error_size = 512;
+static char shm_features_error[shm_features_error_size] = { 0 };
 
 typedef enum {
     SHM_TENSOR_INPUT,
-    SHM_TENSOR_OUTPUT
+    SHM_TENSOR_OUTPUT,
+    SHM_TENSOR_INPUT_BATCH,
+    SHM_COMMAND_QUEUE
 } shm_io_tensor_type;
 
 typedef struct {
@@ -108,6 +161,7 @@ typedef struct {
     size_t features_size;
     shm_io_tensor_type tensor_type;
     uint8_t tensor_index;
+    uint16_t slot;
 } shm_t;
 static std::vector<shm_t> mapped_shms;
 
@@ -147,10 +201,10 @@ static void cleanup_all_shm() {
     mapped_shms.clear();
 }
 
-static shm_t *find_shm(shm_io_tensor_type tensor_type, uint8_t tensor_index) {
+static shm_t *find_shm(shm_io_tensor_type tensor_type, uint8_t tensor_index, uint16_t slot = 0) {
     shm_t *shm = nullptr;
     for (auto& it : mapped_shms) {
-        if (it.tensor_type == tensor_type && it.tensor_index == tensor_index) {
+        if (it.tensor_type == tensor_type && it.tensor_index == tensor_index && it.slot == slot) {
             shm = &it;
             break;
         }
@@ -162,6 +216,7 @@ static int create_shm(
     size_t features_size,
     shm_io_tensor_type tensor_type,
     uint8_t tensor_index,
+    uint16_t slot,
     char *shm_features_error,
     const size_t shm_features_error_size
 ) {
@@ -173,7 +228,8 @@ static int create_shm(
         .features_ptr = nullptr,
         .features_size = features_size * sizeof(float),
         .tensor_type = tensor_type,
-        .tensor_index = tensor_index
+        .tensor_index = tensor_index,
+        .slot = slot
     };
 
     // shm #1: shm_open
@@ -222,178 +278,680 @@ static int create_shm(
     return 0;
 }
 
-void json_send_classification_response(int id,
-                                       uint64_t json_message_handler_entry_ms,
-                                       uint64_t json_parsing_ms,
-                                       uint64_t stdin_ms,
-                                       EI_IMPULSE_ERROR res,
-                                       ei_impulse_result_t *result_ptr,
-                                       bool use_shm,
-                                       char *resp_buffer,
-                                       size_t resp_buffer_size)
-{
-    ei_impulse_result_t result = *result_ptr;
+/**
+ * Point the freeform outputs of the default classifier at the shm output tensors of `slot`.
+ * Requests for other slots switch to their slot and back to slot 0 (which non-shm requests use).
+ */
+static EI_IMPULSE_ERROR use_freeform_output_slot(size_t slot) {
+#if EI_CLASSIFIER_FREEFORM_OUTPUT
+    if (slot >= freeform_output_slots.size()) {
+        return EI_IMPULSE_OK;
+    }
+    return ei_set_freeform_output(freeform_output_slots[slot].data(), freeform_output_slots[slot].size());
+#else
+    return EI_IMPULSE_OK;
+#endif
+}
 
-    if (res != 0) {
-        char err_msg[128];
-        snprintf(err_msg, 128, "Classifying failed, error code was %d", (int)res);
+/**
+ * Create the worker pool for batches, with one classifier instance (own impulse handle, and own
+ * freeform output buffers) per worker. Requires the impulse to be initialized. Returns 0 when OK.
+ */
+static int init_classifier_pool(char *err_msg, size_t err_msg_size) {
+    if (classifier_pool) {
+        return 0;
+    }
 
-        nlohmann::json err = {
-            {"id", id},
-            {"success", false},
-            {"error", err_msg},
-        };
-        snprintf(resp_buffer, resp_buffer_size, "%s\n", err.dump().c_str());
-        return;
+    size_t thread_count = options.worker_threads > 0 ?
+        options.worker_threads :
+        std::max(1U, std::thread::hardware_concurrency());
+
+    for (size_t ix = 0; ix < thread_count; ix++) {
+        classifier_instance_t *instance = new classifier_instance_t();
+        instance->handle = new ei_impulse_handle_t(ei_default_impulse.impulse);
+        run_classifier_init(instance->handle);
+
+#if EI_CLASSIFIER_FREEFORM_OUTPUT
+        instance->freeform_outputs.reserve(ei_default_impulse.impulse->freeform_outputs_size);
+        for (size_t out_ix = 0; out_ix < ei_default_impulse.impulse->freeform_outputs_size; ++out_ix) {
+            instance->freeform_outputs.emplace_back(ei_default_impulse.impulse->freeform_outputs[out_ix], 1);
+        }
+        EI_IMPULSE_ERROR set_freeform_res = ei_set_freeform_output(instance->handle,
+            instance->freeform_outputs.data(), instance->freeform_outputs.size());
+        if (set_freeform_res != EI_IMPULSE_OK) {
+            snprintf(err_msg, err_msg_size, "ei_set_freeform_output() failed with code %d for worker %d",
+                set_freeform_res, (int)ix);
+            delete instance->handle;
+            delete instance;
+            return -1;
+        }
+#endif
+
+        pool_classifiers.push_back(instance);
     }
 
+    classifier_pool = new WorkerPool(pool_classifiers.size());
+    return 0;
+}
+
+#if defined(__linux__)
+/**
+ * Shared memory command queue (see inc/eim_shm_queue.h). A dedicated thread consumes the request
+ * ring, classifies the referenced shm slot with the default classifier, and publishes a binary
+ * response (with the classification scores) in the response ring.
+ */
+#define EIM_SHM_QUEUE_ERROR_INVALID_SLOT    -100
+#define EIM_SHM_QUEUE_ERROR_INVALID_TYPE    -101
+
+static std::thread shm_queue_thread;
+static std::atomic<bool> shm_queue_stopping(false);
+
+static uint32_t shm_queue_value_count() {
 #if EI_CLASSIFIER_OBJECT_DETECTION == 1
-    #if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+    return 0;
+#else
+    return EI_CLASSIFIER_LABEL_COUNT;
+#endif
+}
 
-        // For object tracking we'll create a separate object with traces (we also fill bounding_boxes with the raw output)
-        nlohmann::json tracking_res = nlohmann::json::array();
-        for (uint32_t ix = 0; ix < result.postprocessed_output.object_tracking_output.open_traces_count; ix++) {
-            ei_object_tracking_trace_t trace = result.postprocessed_output.object_tracking_output.open_traces[ix];
-
-            nlohmann::json tracking_json = {
-                {"object_id", trace.id},
-                {"label", trace.label},
-                {"value", trace.value == 0.0f ? 1.0f : trace.value},
-                {"x", trace.x},
-                {"y", trace.y},
-                {"width", trace.width},
-                {"height", trace.height},
-            };
-            tracking_res.push_back(tracking_json);
+static void shm_queue_handle_request(const eim_shm_queue_request_t *req, eim_shm_queue_response_t *resp) {
+    memset(resp, 0, sizeof(eim_shm_queue_response_t));
+    resp->id = req->id;
+    resp->slot = req->slot;
+
+    shm_t *shm = req->slot < options.shm_slots ? find_shm(SHM_TENSOR_INPUT, 0, req->slot) : nullptr;
+    if (!shm) {
+        resp->error = EIM_SHM_QUEUE_ERROR_INVALID_SLOT;
+        return;
+    }
+    if (req->type != EIM_SHM_QUEUE_CLASSIFY && req->type != EIM_SHM_QUEUE_CLASSIFY_CONTINUOUS) {
+        resp->error = EIM_SHM_QUEUE_ERROR_INVALID_TYPE;
+        return;
+    }
+
+    const bool continuous = req->type == EIM_SHM_QUEUE_CLASSIFY_CONTINUOUS;
+    const bool debug = req->flags & EIM_SHM_QUEUE_FLAG_DEBUG;
+
+    std::lock_guard<std::mutex> lock(default_classifier_mutex);
+
+    ei_impulse_result_t result;
+    memset(&result, 0, sizeof(ei_impulse_result_t));
+    signal_t signal;
+    numpy::signal_from_buffer(shm->features_ptr,
+        continuous ? EI_CLASSIFIER_SLICE_SIZE : EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+
+    EI_IMPULSE_ERROR res = use_freeform_output_slot(req->slot);
+    if (res == EI_IMPULSE_OK) {
+        res = continuous ?
+            run_classifier_continuous(&signal, &result, debug, true) :
+            run_classifier(&signal, &result, debug);
+        use_freeform_output_slot(0);
+    }
+
+    resp->error = (int16_t)res;
+    if (res != EI_IMPULSE_OK) {
+        return;
+    }
+
+    resp->dsp_us = (uint32_t)result.timing.dsp_us;
+    resp->classification_us = (uint32_t)result.timing.classification_us;
+    resp->anomaly_us = (uint32_t)result.timing.anomaly_us;
+#if EI_CLASSIFIER_HAS_ANOMALY > 0
+    resp->anomaly = result.anomaly;
+#endif
+    resp->value_count = shm_queue_value_count();
+#if EI_CLASSIFIER_OBJECT_DETECTION != 1 && EI_CLASSIFIER_LABEL_COUNT > 0
+    float *values = (float *)(resp + 1);
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        values[ix] = result.classification[ix].value;
+    }
+#endif
+}
+
+static void shm_queue_main(eim_shm_queue_header_t *q) {
+    // wake up every now and then even without requests, so we notice when we need to stop
+    const struct timespec idle_timeout = { 0, 500 * 1000 * 1000 };
+
+    uint32_t tail = eim_shm_queue_load(&q->request_tail);
+
+    while (!shm_queue_stopping) {
+        if (eim_shm_queue_load(&q->request_head) == tail) {
+            eim_shm_queue_store(&q->runner_waiting, 1);
+            if (eim_shm_queue_load(&q->request_head) == tail) {
+                eim_futex_wait(&q->request_head, tail, &idle_timeout);
+            }
+            eim_shm_queue_store(&q->runner_waiting, 0);
+            continue;
         }
 
-    #endif // EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+        // copy the request, so the client cannot change it underneath us
+        eim_shm_queue_request_t req = *eim_shm_queue_request_at(q, tail);
+
+        // wait for the client to make room in the response ring
+        uint32_t resp_head = q->response_head;
+        uint32_t resp_tail;
+        while ((resp_head - (resp_tail = eim_shm_queue_load(&q->response_tail))) >= q->response_capacity) {
+            if (shm_queue_stopping) return;
+            const struct timespec full_timeout = { 0, 1000 * 1000 };
+            eim_futex_wait(&q->response_tail, resp_tail, &full_timeout);
+        }
+
+        shm_queue_handle_request(&req, eim_shm_queue_response_at(q, resp_head));
+
+        eim_shm_queue_store(&q->request_tail, ++tail);
+        eim_shm_queue_store(&q->response_head, resp_head + 1);
+        if (eim_shm_queue_load(&q->client_waiting)) {
+            eim_futex_wake(&q->response_head);
+        }
+    }
+}
+
+static void start_shm_queue() {
+    shm_t *shm = find_shm(SHM_COMMAND_QUEUE, 0);
+    if (!shm || shm_queue_thread.joinable()) {
+        return;
+    }
+
+    eim_shm_queue_header_t *q = (eim_shm_queue_header_t *)shm->features_ptr;
+    memset(q, 0, sizeof(eim_shm_queue_header_t));
+    q->magic = EIM_SHM_QUEUE_MAGIC;
+    q->version = EIM_SHM_QUEUE_VERSION;
+    q->request_capacity = options.shm_queue_size;
+    q->response_capacity = options.shm_queue_size;
+    q->request_offset = sizeof(eim_shm_queue_header_t);
+    q->response_offset = q->request_offset + q->request_capacity * sizeof(eim_shm_queue_request_t);
+    q->response_entry_size = sizeof(eim_shm_queue_response_t) + shm_queue_value_count() * sizeof(float);
+
+    shm_queue_stopping = false;
+    shm_queue_thread = std::thread(shm_queue_main, q);
+}
+
+static void stop_shm_queue() {
+    if (!shm_queue_thread.joinable()) {
+        return;
+    }
+    shm_queue_stopping = true;
+    shm_t *shm = find_shm(SHM_COMMAND_QUEUE, 0);
+    if (shm) {
+        eim_futex_wake(&((eim_shm_queue_header_t *)shm->features_ptr)->request_head);
+    }
+    shm_queue_thread.join();
+}
+#endif // __linux__
+
+/**
+ * Pre-escaped (quoted) label strings, built once when the impulse is initialized, so writing
+ * a response never has to escape labels again. Keyed by pointer, as the labels in the results
+ * point into ei_classifier_inferencing_categories.
+ */
+static std::vector<std::string> escaped_labels;
+static std::map<const char *, size_t> escaped_label_ix;
+
+static void init_escaped_labels() {
+    escaped_labels.clear();
+    escaped_label_ix.clear();
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        escaped_labels.push_back(json_escape_string(ei_classifier_inferencing_categories[ix]));
+        escaped_label_ix[ei_classifier_inferencing_categories[ix]] = ix;
+    }
+}
+
+/**
+ * Initialize the impulse, and create the shared memory tensors. This is done once per process
+ * (on the first 'hello'), all clients share the impulse and the shm tensors afterwards.
+ * Returns 0 when OK (shm failures are not fatal, they're stored in shm_features_error).
+ */
+static int init_impulse_once(char *err_msg, size_t err_msg_size) {
+    if (impulse_initialized) {
+        return 0;
+    }
+
+    cleanup_all_shm();
+
+    run_classifier_init();
+
+    const ei_impulse_t *impulse = ei_default_impulse.impulse;
+
+    // create shared memory (input, and freeform outputs)
+    memset(shm_features_error, 0, shm_features_error_size);
+    int shm_err = 0;
+
+    // one input tensor and one set of freeform output tensors per slot, so clients can fill the next
+    // slot while the current one is being classified
+    for (size_t slot = 0; slot < options.shm_slots && shm_err == 0; slot++) {
+        shm_err = create_shm(EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, SHM_TENSOR_INPUT, 0, slot, shm_features_error, shm_features_error_size);
+        for (size_t ix = 0; ix < impulse->freeform_outputs_size && shm_err == 0; ix++) {
+            shm_err = create_shm(impulse->freeform_outputs[ix], SHM_TENSOR_OUTPUT, ix, slot, shm_features_error, shm_features_error_size);
+        }
+    }
+    if (shm_err == 0 && options.max_batch_size > 0) {
+        shm_err = create_shm(options.max_batch_size * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, SHM_TENSOR_INPUT_BATCH, 0, 0,
+            shm_features_error, shm_features_error_size);
+    }
+#if defined(__linux__)
+    if (shm_err == 0 && options.shm_queue_size > 0) {
+        size_t queue_bytes = eim_shm_queue_size_bytes(options.shm_queue_size, options.shm_queue_size, shm_queue_value_count());
+        shm_err = create_shm((queue_bytes + sizeof(float) - 1) / sizeof(float), SHM_COMMAND_QUEUE, 0, 0,
+            shm_features_error, shm_features_error_size);
+    }
+#endif
+
+    if (shm_err != 0) {
+        cleanup_all_shm();
+    }
+    // end creating shared memory
+
+#if EI_CLASSIFIER_FREEFORM_OUTPUT
+    std::vector<matrix_t>& freeform_outputs = default_classifier.freeform_outputs;
+    freeform_outputs.clear();
+    freeform_outputs.reserve(ei_default_impulse.impulse->freeform_outputs_size);
+
+    for (size_t ix = 0; ix < ei_default_impulse.impulse->freeform_outputs_size; ++ix) {
+        float *buffer = nullptr;
+
+        // if we're using shared memory... then create the freeform_outputs matrices using the shared memory as storage
+        // (so we don't need to map anything back later)
+        if (shm_err == 0) {
+            shm_t *shm_output_tensor = find_shm(SHM_TENSOR_OUTPUT, ix);
+            if (!shm_output_tensor) {
+                snprintf(err_msg, err_msg_size, "Cannot find shm output tensor %d (but shm_err == 0)", (int)ix);
+                return -1;
+            }
+
+            buffer = shm_output_tensor->features_ptr;
+        }
+
+        freeform_outputs.emplace_back(ei_default_impulse.impulse->freeform_outputs[ix], 1, buffer);
+    }
+
+    EI_IMPULSE_ERROR set_freeform_res = ei_set_freeform_output(freeform_outputs.data(), freeform_outputs.size());
+    if (set_freeform_res != EI_IMPULSE_OK) {
+        snprintf(err_msg, err_msg_size, "ei_set_freeform_output() failed with code %d", set_freeform_res);
+        return -1;
+    }
+
+    freeform_output_slots.clear();
+    if (shm_err == 0) {
+        freeform_output_slots.resize(options.shm_slots);
+        for (size_t slot = 0; slot < options.shm_slots; slot++) {
+            freeform_output_slots[slot].reserve(ei_default_impulse.impulse->freeform_outputs_size);
+            for (size_t ix = 0; ix < ei_default_impulse.impulse->freeform_outputs_size; ++ix) {
+                shm_t *shm_output_tensor = find_shm(SHM_TENSOR_OUTPUT, ix, slot);
+                if (!shm_output_tensor) {
+                    snprintf(err_msg, err_msg_size, "Cannot find shm output tensor %d for slot %d (but shm_err == 0)",
+                        (int)ix, (int)slot);
+                    return -1;
+                }
+                freeform_output_slots[slot].emplace_back(ei_default_impulse.impulse->freeform_outputs[ix], 1,
+                    shm_output_tensor->features_ptr);
+            }
+        }
+    }
+#endif
+
+    init_escaped_labels();
+
+#if defined(__linux__)
+    if (shm_err == 0) {
+        start_shm_queue();
+    }
+#endif
+
+    impulse_initialized = true;
+    return 0;
+}
 
-    nlohmann::json bb_res = nlohmann::json::array();
-    for (size_t ix = 0; ix < result.bounding_boxes_count; ix++) {
-        auto bb = result.bounding_boxes[ix];
+static void write_label(ResponseWriter &writer, const char *label) {
+    auto it = escaped_label_ix.find(label);
+    if (it != escaped_label_ix.end()) {
+        const std::string& escaped = escaped_labels[it->second];
+        writer.RawValue(escaped.c_str(), escaped.length(), rapidjson::kStringType);
+    }
+    else {
+        writer.String(label ? label : "");
+    }
+}
+
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1 || EI_CLASSIFIER_HAS_VISUAL_ANOMALY
+static void write_bounding_box(ResponseWriter &writer, const ei_impulse_result_bounding_box_t& bb) {
+    writer.StartObject();
+    writer.Key("label");
+    write_label(writer, bb.label);
+    writer.Key("value");
+    write_float(writer, bb.value);
+    writer.Key("x");
+    writer.Uint(bb.x);
+    writer.Key("y");
+    writer.Uint(bb.y);
+    writer.Key("width");
+    writer.Uint(bb.width);
+    writer.Key("height");
+    writer.Uint(bb.height);
+    writer.EndObject();
+}
+#endif // EI_CLASSIFIER_OBJECT_DETECTION == 1 || EI_CLASSIFIER_HAS_VISUAL_ANOMALY
+
+/**
+ * Write the "result" object for a classification (labels, boxes, tracking traces, anomaly, freeform...)
+ */
+static void write_classification_result(ResponseWriter &writer, const classifier_instance_t *classifier,
+                                        const ei_impulse_result_t *result, bool use_shm) {
+    writer.StartObject();
+
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+    writer.Key("bounding_boxes");
+    writer.StartArray();
+    for (size_t ix = 0; ix < result->bounding_boxes_count; ix++) {
+        const auto& bb = result->bounding_boxes[ix];
         if (bb.value == 0) {
             continue;
         }
-        nlohmann::json bb_json = {
-            {"label", bb.label},
-            {"value", bb.value},
-            {"x", bb.x},
-            {"y", bb.y},
-            {"width", bb.width},
-            {"height", bb.height},
-        };
-        bb_res.push_back(bb_json);
+        write_bounding_box(writer, bb);
     }
+    writer.EndArray();
 
+    #if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+    // For object tracking we'll create a separate object with traces (we also fill bounding_boxes with the raw output)
+    writer.Key("object_tracking");
+    writer.StartArray();
+    for (uint32_t ix = 0; ix < result->postprocessed_output.object_tracking_output.open_traces_count; ix++) {
+        const ei_object_tracking_trace_t& trace = result->postprocessed_output.object_tracking_output.open_traces[ix];
+
+        writer.StartObject();
+        writer.Key("object_id");
+        writer.Uint(trace.id);
+        writer.Key("label");
+        write_label(writer, trace.label);
+        writer.Key("value");
+        write_float(writer, trace.value == 0.0f ? 1.0f : trace.value);
+        writer.Key("x");
+        writer.Uint(trace.x);
+        writer.Key("y");
+        writer.Uint(trace.y);
+        writer.Key("width");
+        writer.Uint(trace.width);
+        writer.Key("height");
+        writer.Uint(trace.height);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    #endif // EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
 #else
     #if EI_CLASSIFIER_LABEL_COUNT > 0
-    nlohmann::json classify_res;
+    writer.Key("classification");
+    writer.StartObject();
     for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        classify_res[result.classification[ix].label] = result.classification[ix].value;
+        write_label(writer, result->classification[ix].label);
+        write_float(writer, result->classification[ix].value);
     }
+    writer.EndObject();
     #endif // EI_CLASSIFIER_LABEL_COUNT > 0
-#endif
+#endif // EI_CLASSIFIER_OBJECT_DETECTION
 
 #if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-    nlohmann::json visual_ad_res = nlohmann::json::array();
-    for (size_t ix = 0; ix < result.visual_ad_count; ix++) {
-        auto bb = result.visual_ad_grid_cells[ix];
+    writer.Key("visual_anomaly_grid");
+    writer.StartArray();
+    for (size_t ix = 0; ix < result->visual_ad_count; ix++) {
+        const auto& bb = result->visual_ad_grid_cells[ix];
         if (bb.value == 0) {
             continue;
         }
-        nlohmann::json bb_json = {
-            {"label", bb.label},
-            {"value", bb.value},
-            {"x", bb.x},
-            {"y", bb.y},
-            {"width", bb.width},
-            {"height", bb.height},
-        };
-        visual_ad_res.push_back(bb_json);
+        write_bounding_box(writer, bb);
     }
+    writer.EndArray();
+    writer.Key("visual_anomaly_max");
+    write_float(writer, result->visual_ad_result.max_value);
+    writer.Key("visual_anomaly_mean");
+    write_float(writer, result->visual_ad_result.mean_value);
 #endif // EI_CLASSIFIER_HAS_VISUAL_ANOMALY
 
-#if EI_CLASSIFIER_FREEFORM_OUTPUT
-    nlohmann::json freeform_res;
+#if EI_CLASSIFIER_HAS_ANOMALY > 0
+    writer.Key("anomaly");
+    write_float(writer, result->anomaly);
+#endif // EI_CLASSIFIER_HAS_ANOMALY == 1
 
+#if EI_CLASSIFIER_FREEFORM_OUTPUT
+    writer.Key("freeform");
     if (use_shm) {
         // shm -> already in memory
-        freeform_res = "shm";
+        writer.String("shm");
     }
     else {
         // otherwise -> copy it back
-        freeform_res = nlohmann::json::array();
-        for (size_t ix = 0; ix < freeform_outputs.size(); ix++) {
-            const matrix_t& freeform_output = freeform_outputs[ix];
-
-            nlohmann::json freeform_entry(
-                std::vector<float>(freeform_output.buffer, freeform_output.buffer + (freeform_output.rows * freeform_output.cols))
-            );
-            freeform_res.push_back(freeform_entry);
+        writer.StartArray();
+        for (size_t ix = 0; ix < classifier->freeform_outputs.size(); ix++) {
+            const matrix_t& freeform_output = classifier->freeform_outputs[ix];
+            const size_t elements = freeform_output.rows * freeform_output.cols;
+
+            writer.StartArray();
+            for (size_t el = 0; el < elements; el++) {
+                write_float(writer, freeform_output.buffer[el]);
+            }
+            writer.EndArray();
         }
+        writer.EndArray();
     }
 #endif // EI_CLASSIFIER_FREEFORM_OUTPUT
 
-    uint64_t total_ms = ei_read_timer_ms() - json_message_handler_entry_ms;
+    writer.EndObject();
+}
 
-    nlohmann::json resp = {
+/**
+ * Write a JSON-protocol error response into resp_buffer
+ */
+static void json_send_error_response(int id, const char *err_msg, char *resp_buffer, size_t resp_buffer_size) {
+    nlohmann::json err = {
         {"id", id},
-        {"success", true},
-        {"result", {
-#if EI_CLASSIFIER_OBJECT_DETECTION == 1
-            {"bounding_boxes", bb_res},
-    #if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
-            {"object_tracking", tracking_res},
-    #endif
-#else
-    #if EI_CLASSIFIER_LABEL_COUNT > 0
-            {"classification", classify_res},
-    #endif // EI_CLASSIFIER_LABEL_COUNT > 0
-#endif // EI_CLASSIFIER_OBJECT_DETECTION
-#if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-            {"visual_anomaly_grid", visual_ad_res},
-            {"visual_anomaly_max", result.visual_ad_result.max_value},
-            {"visual_anomaly_mean", result.visual_ad_result.mean_value},
-#endif // EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-#if EI_CLASSIFIER_HAS_ANOMALY > 0
-            {"anomaly", result.anomaly},
-#endif // EI_CLASSIFIER_HAS_ANOMALY == 1
-#if EI_CLASSIFIER_FREEFORM_OUTPUT
-            {"freeform", freeform_res},
-#endif // #if EI_CLASSIFIER_FREEFORM_OUTPUT
-        }},
-        {"timing", {
-            {"dsp", result.timing.dsp},
-            {"classification", result.timing.classification},
-            {"anomaly", result.timing.anomaly},
-            {"json", json_parsing_ms},
-            {"stdin", stdin_ms},
-            {"msg_handler", total_ms},
-        }},
+        {"success", false},
+        {"error", err_msg},
     };
+    snprintf(resp_buffer, resp_buffer_size, "%s\n", err.dump().c_str());
+}
+
+// one writer per thread, so the writer's internal stack is allocated once and then reused
+static thread_local ResponseBufferStream response_stream;
+static thread_local ResponseWriter response_writer;
+
+void json_send_classification_response(int id,
+                                       uint64_t json_message_handler_entry_ms,
+                                       uint64_t json_parsing_ms,
+                                       uint64_t stdin_ms,
+                                       EI_IMPULSE_ERROR res,
+                                       const ei_impulse_result_t *result,
+                                       bool use_shm,
+                                       char *resp_buffer,
+                                       size_t resp_buffer_size)
+{
+    if (res != 0) {
+        char err_msg[128];
+        snprintf(err_msg, 128, "Classifying failed, error code was %d", (int)res);
+        json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+        return;
+    }
+
+    // write straight into the response buffer (keeping room for the newline and terminator)
+    response_stream.Reset(resp_buffer, resp_buffer_size - 2);
+    response_writer.Reset(response_stream);
+    ResponseWriter& writer = response_writer;
+
+    writer.StartObject();
+    writer.Key("id");
+    writer.Int(id);
+    writer.Key("success");
+    writer.Bool(true);
+    writer.Key("result");
+    write_classification_result(writer, &default_classifier, result, use_shm);
+
+    uint64_t total_ms = ei_read_timer_ms() - json_message_handler_entry_ms;
+
+    writer.Key("timing");
+    writer.StartObject();
+    writer.Key("dsp");
+    writer.Int(result->timing.dsp);
+    writer.Key("classification");
+    writer.Int(result->timing.classification);
+    writer.Key("anomaly");
+    writer.Int(result->timing.anomaly);
+    writer.Key("json");
+    writer.Uint64(json_parsing_ms);
+    writer.Key("stdin");
+    writer.Uint64(stdin_ms);
+    writer.Key("msg_handler");
+    writer.Uint64(total_ms);
+    writer.EndObject();
+
     if (engine_info.str().length() > 0) {
-        resp["info"] = engine_info.str();
+        writer.Key("info");
+        writer.String(engine_info.str().c_str());
     }
+    writer.EndObject();
 
-    int bytes_written = snprintf(resp_buffer, resp_buffer_size, "%s\n", resp.dump().c_str());
-    if (bytes_written > (int)resp_buffer_size) {
+    if (response_stream.overflowed()) {
         char err_msg[512];
         snprintf(err_msg, 512, "Classification response (%d bytes) was larger than max response buffer size (%d bytes)",
-            (int)bytes_written,
+            (int)response_stream.length(),
             (int)resp_buffer_size);
+        json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+        return;
+    }
 
-        nlohmann::json err = {
-            {"id", id},
-            {"success", false},
-            {"error", err_msg},
-        };
-        snprintf(resp_buffer, resp_buffer_size, "%s\n", err.dump().c_str());
+    size_t length = response_stream.length();
+    resp_buffer[length++] = '\n';
+    resp_buffer[length] = '\0';
+}
+
+// output of one item in a batch, the result object is serialized on the worker (as the result
+// points into buffers owned by the worker's classifier instance)
+typedef struct {
+    EI_IMPULSE_ERROR res;
+    ei_impulse_result_timing_t timing;
+    std::string result_json;
+} batch_item_result_t;
+
+/**
+ * Serialize the "result" object into `out` (grows a per-thread scratch buffer as needed)
+ */
+static void write_classification_result_to_string(const classifier_instance_t *classifier,
+                                                  const ei_impulse_result_t *result, bool use_shm, std::string &out)
+{
+    static thread_local std::vector<char> scratch(64 * 1024);
+
+    while (1) {
+        response_stream.Reset(scratch.data(), scratch.size());
+        response_writer.Reset(response_stream);
+        write_classification_result(response_writer, classifier, result, use_shm);
+        if (!response_stream.overflowed()) {
+            break;
+        }
+        scratch.resize(std::max(scratch.size() * 2, response_stream.length()));
+    }
+    out.assign(scratch.data(), response_stream.length());
+}
+
+/**
+ * Classify `count` frames (EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE features each, back to back in `features`)
+ * spread over the worker pool, and write one response with all results (in order) into resp_buffer.
+ */
+static void classify_batch(int id, const float *features, size_t count, bool debug,
+                           uint64_t json_message_handler_entry_ms, uint64_t json_parsing_ms, uint64_t stdin_ms,
+                           char *resp_buffer, size_t resp_buffer_size)
+{
+    char err_msg[256] = { 0 };
+    if (init_classifier_pool(err_msg, sizeof(err_msg)) != 0) {
+        json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+        return;
+    }
+
+    std::vector<batch_item_result_t> items(count);
+    CountDownLatch done(count);
+
+    for (size_t ix = 0; ix < count; ix++) {
+        classifier_pool->submit([&, ix](size_t worker_ix) {
+            classifier_instance_t *classifier = pool_classifiers[worker_ix];
+            batch_item_result_t& item = items[ix];
+
+            ei_impulse_result_t result;
+            memset(&result, 0, sizeof(ei_impulse_result_t));
+            signal_t signal;
+            numpy::signal_from_buffer(features + (ix * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE),
+                EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+
+            item.res = run_classifier(classifier->handle, &signal, &result, debug);
+            item.timing = result.timing;
+            if (item.res == EI_IMPULSE_OK) {
+                write_classification_result_to_string(classifier, &result, false /* use_shm */, item.result_json);
+            }
+            done.count_down();
+        });
+    }
+    done.wait();
+
+    for (size_t ix = 0; ix < count; ix++) {
+        if (items[ix].res != EI_IMPULSE_OK) {
+            snprintf(err_msg, sizeof(err_msg), "Classifying item %d in batch failed, error code was %d",
+                (int)ix, (int)items[ix].res);
+            json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+            return;
+        }
+    }
+
+    response_stream.Reset(resp_buffer, resp_buffer_size - 2);
+    response_writer.Reset(response_stream);
+    ResponseWriter& writer = response_writer;
+
+    int64_t dsp_ms = 0, classification_ms = 0, anomaly_ms = 0;
+
+    writer.StartObject();
+    writer.Key("id");
+    writer.Int(id);
+    writer.Key("success");
+    writer.Bool(true);
+    writer.Key("results");
+    writer.StartArray();
+    for (auto& item : items) {
+        writer.RawValue(item.result_json.c_str(), item.result_json.length(), rapidjson::kObjectType);
+        dsp_ms += item.timing.dsp;
+        classification_ms += item.timing.classification;
+        anomaly_ms += item.timing.anomaly;
+    }
+    writer.EndArray();
+
+    uint64_t total_ms = ei_read_timer_ms() - json_message_handler_entry_ms;
+
+    // dsp/classification/anomaly are summed over all items (so can be > msg_handler)
+    writer.Key("timing");
+    writer.StartObject();
+    writer.Key("dsp");
+    writer.Int64(dsp_ms);
+    writer.Key("classification");
+    writer.Int64(classification_ms);
+    writer.Key("anomaly");
+    writer.Int64(anomaly_ms);
+    writer.Key("json");
+    writer.Uint64(json_parsing_ms);
+    writer.Key("stdin");
+    writer.Uint64(stdin_ms);
+    writer.Key("msg_handler");
+    writer.Uint64(total_ms);
+    writer.Key("threads");
+    writer.Uint64(classifier_pool->size());
+    writer.EndObject();
+    writer.EndObject();
+
+    if (response_stream.overflowed()) {
+        snprintf(err_msg, sizeof(err_msg), "Batch response (%d bytes) was larger than max response buffer size (%d bytes)",
+            (int)response_stream.length(),
+            (int)resp_buffer_size);
+        json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
         return;
     }
+
+    size_t length = response_stream.length();
+    resp_buffer[length++] = '\n';
+    resp_buffer[length] = '\0';
 }
 
-void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t resp_buffer_size, uint64_t json_parsing_ms, uint64_t stdin_ms) {
+void json_message_handler(runner_state_t *state, rapidjson::Document &msg, char *resp_buffer, size_t resp_buffer_size, uint64_t json_parsing_ms, uint64_t stdin_ms) {
     rapidjson::Value& id_v = msg["id"];
     if (!id_v.IsInt()) {
         nlohmann::json err = {
@@ -407,15 +965,19 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
     auto id = id_v.GetInt();
     uint64_t start_ms = ei_read_timer_ms();
 
+    std::lock_guard<std::mutex> lock(default_classifier_mutex);
+
     rapidjson::Value& hello = msg["hello"];
     rapidjson::Value& classify_data = msg["classify"];
     rapidjson::Value& classify_data_shm = msg["classify_shm"];
     rapidjson::Value& classify_data_continuous = msg["classify_continuous"];
     rapidjson::Value& classify_data_continuous_shm = msg["classify_continuous_shm"];
+    rapidjson::Value& classify_batch_data = msg["classify_batch"];
+    rapidjson::Value& classify_batch_data_shm = msg["classify_batch_shm"];
     rapidjson::Value& set_threshold = msg["set_threshold"];
 
     if (hello.IsInt()) {
-        if (state.initialized) {
+        if (state->initialized) {
             nlohmann::json err = {
                 {"id", id},
                 {"success", false},
@@ -435,74 +997,35 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
             return;
         }
 
-        cleanup_all_shm();
-
-        run_classifier_init();
-
-        const ei_impulse_t *impulse = ei_default_impulse.impulse;
-
-        // create shared memory (input, and freeform outputs)
-        const size_t shm_features_error_size = 512;
-        char shm_features_error[shm_features_error_size] = { 0 };
-        int shm_err = 0;
-
-        shm_err = create_shm(EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, SHM_TENSOR_INPUT, 0, shm_features_error, shm_features_error_size);
-        if (shm_err == 0) {
-            for (size_t ix = 0; ix < impulse->freeform_outputs_size; ix++) {
-                shm_err = create_shm(impulse->freeform_outputs[ix], SHM_TENSOR_OUTPUT, ix, shm_features_error, shm_features_error_size);
-                if (shm_err != 0) {
-                    break;
-                }
+        runner_protocol_t protocol = PROTOCOL_JSON;
+        if (msg.HasMember("protocol")) {
+            const rapidjson::Value& protocol_v = msg["protocol"];
+            if (protocol_v.IsString() && strcmp(protocol_v.GetString(), "binary") == 0) {
+                protocol = PROTOCOL_BINARY;
             }
-        }
-
-        if (shm_err != 0) {
-            cleanup_all_shm();
-        }
-        // end creating shared memory
-
-#if EI_CLASSIFIER_FREEFORM_OUTPUT
-        freeform_outputs.reserve(ei_default_impulse.impulse->freeform_outputs_size);
-
-        for (size_t ix = 0; ix < ei_default_impulse.impulse->freeform_outputs_size; ++ix) {
-            float *buffer = nullptr;
-
-            // if we're using shared memory... then create the freeform_outputs matrices using the shared memory as storage
-            // (so we don't need to map anything back later)
-            if (shm_err == 0) {
-                shm_t *shm_output_tensor = find_shm(SHM_TENSOR_OUTPUT, ix);
-                if (!shm_output_tensor) {
-                    char err_msg[128];
-                    snprintf(err_msg, 128, "Cannot find shm output tensor %d (but shm_err == 0)", (int)ix);
-
-                    nlohmann::json err = {
-                        {"id", id},
-                        {"success", false},
-                        {"error", err_msg},
-                    };
-                    snprintf(resp_buffer, resp_buffer_size, "%s\n", err.dump().c_str());
-                    return;
-                }
-
-                buffer = shm_output_tensor->features_ptr;
+            else if (!protocol_v.IsString() || strcmp(protocol_v.GetString(), "json") != 0) {
+                nlohmann::json err = {
+                    {"id", id},
+                    {"success", false},
+                    {"error", "Invalid value for 'protocol', should be either 'json' or 'binary'"},
+                };
+                snprintf(resp_buffer, resp_buffer_size, "%s\n", err.dump().c_str());
+                return;
             }
-
-            freeform_outputs.emplace_back(ei_default_impulse.impulse->freeform_outputs[ix], 1, buffer);
         }
 
-        EI_IMPULSE_ERROR set_freeform_res = ei_set_freeform_output(freeform_outputs.data(), freeform_outputs.size());
-        if (set_freeform_res != EI_IMPULSE_OK) {
-            char err_msg[128];
-            snprintf(err_msg, 128, "ei_set_freeform_output() failed with code %d", set_freeform_res);
+        char init_err[256] = { 0 };
+        if (init_impulse_once(init_err, sizeof(init_err)) != 0) {
             nlohmann::json err = {
                 {"id", id},
                 {"success", false},
-                {"error", err_msg},
+                {"error", init_err},
             };
             snprintf(resp_buffer, resp_buffer_size, "%s\n", err.dump().c_str());
             return;
         }
-#endif
+
+        const ei_impulse_t *impulse = ei_default_impulse.impulse;
 
         vector<std::string> engine_properties;
         vector<std::string> labels;
@@ -626,39 +1149,96 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
             resp["features_shm_error"] = shm_features_error;
         }
         else {
-            shm_t *shm_input_tensor = find_shm(SHM_TENSOR_INPUT, 0);
-            if (shm_input_tensor && shm_input_tensor->features_ptr != nullptr) {
-                resp["features_shm"] = {
-                    {"name", shm_input_tensor->name.c_str()},
-                    {"size_bytes", shm_input_tensor->features_size},
-                    {"type", "float32"},
-                    {"elements", shm_input_tensor->features_size / sizeof(float)},
+            // slot 0 is reported as 'features_shm' / 'freeform_output_shm' (as with a single slot),
+            // all slots are listed in 'shm_slots'
+            nlohmann::json shm_slots = nlohmann::json::array();
+            for (size_t slot = 0; slot < options.shm_slots; slot++) {
+                nlohmann::json slot_obj = {
+                    {"slot", slot},
+                };
+
+                shm_t *shm_input_tensor = find_shm(SHM_TENSOR_INPUT, 0, slot);
+                if (shm_input_tensor && shm_input_tensor->features_ptr != nullptr) {
+                    slot_obj["features_shm"] = {
+                        {"name", shm_input_tensor->name.c_str()},
+                        {"size_bytes", shm_input_tensor->features_size},
+                        {"type", "float32"},
+                        {"elements", shm_input_tensor->features_size / sizeof(float)},
+                    };
+                }
+                if (impulse->freeform_outputs_size > 0) {
+                    nlohmann::json output_tensors_shm = nlohmann::json::array();
+                    for (size_t ix = 0; ix < impulse->freeform_outputs_size; ix++) {
+                        shm_t *shm_output_tensor = find_shm(SHM_TENSOR_OUTPUT, ix, slot);
+                        if (!shm_output_tensor) continue;
+                        nlohmann::json output = {
+                            {"index", shm_output_tensor->tensor_index},
+                            {"name", shm_output_tensor->name.c_str()},
+                            {"size_bytes", shm_output_tensor->features_size},
+                            {"type", "float32"},
+                            {"elements", shm_output_tensor->features_size / sizeof(float)},
+                        };
+                        output_tensors_shm.push_back(output);
+                    }
+                    slot_obj["freeform_output_shm"] = output_tensors_shm;
+                }
+
+                if (slot == 0) {
+                    if (slot_obj.contains("features_shm")) {
+                        resp["features_shm"] = slot_obj["features_shm"];
+                    }
+                    if (slot_obj.contains("freeform_output_shm")) {
+                        resp["freeform_output_shm"] = slot_obj["freeform_output_shm"];
+                    }
+                }
+                shm_slots.push_back(slot_obj);
+            }
+            resp["shm_slots"] = shm_slots;
+
+#if defined(__linux__)
+            shm_t *shm_queue = find_shm(SHM_COMMAND_QUEUE, 0);
+            if (shm_queue && shm_queue->features_ptr != nullptr) {
+                const eim_shm_queue_header_t *q = (const eim_shm_queue_header_t *)shm_queue->features_ptr;
+                resp["shm_command_queue"] = {
+                    {"name", shm_queue->name.c_str()},
+                    {"size_bytes", shm_queue->features_size},
+                    {"version", q->version},
+                    {"request_capacity", q->request_capacity},
+                    {"response_capacity", q->response_capacity},
+                    {"request_offset", q->request_offset},
+                    {"response_offset", q->response_offset},
+                    {"response_entry_size", q->response_entry_size},
+                    {"value_count", shm_queue_value_count()},
                 };
             }
-            if (impulse->freeform_outputs_size > 0) {
-                nlohmann::json output_tensors_shm = nlohmann::json::array();
-                for (size_t ix = 0; ix < impulse->freeform_outputs_size; ix++) {
-                    shm_t *shm_output_tensor = find_shm(SHM_TENSOR_OUTPUT, ix);
-                    if (!shm_output_tensor) continue;
-                    nlohmann::json output = {
-                        {"index", shm_output_tensor->tensor_index},
-                        {"name", shm_output_tensor->name.c_str()},
-                        {"size_bytes", shm_output_tensor->features_size},
-                        {"type", "float32"},
-                        {"elements", shm_output_tensor->features_size / sizeof(float)},
-                    };
-                    output_tensors_shm.push_back(output);
-                }
-                resp["freeform_output_shm"] = output_tensors_shm;
+#endif
+            shm_t *shm_batch_tensor = find_shm(SHM_TENSOR_INPUT_BATCH, 0);
+            if (shm_batch_tensor && shm_batch_tensor->features_ptr != nullptr) {
+                resp["batch_features_shm"] = {
+                    {"name", shm_batch_tensor->name.c_str()},
+                    {"size_bytes", shm_batch_tensor->features_size},
+                    {"type", "float32"},
+                    {"elements", shm_batch_tensor->features_size / sizeof(float)},
+                    {"max_batch_size", options.max_batch_size},
+                };
             }
         }
 
+        if (protocol == PROTOCOL_BINARY) {
+            resp["protocol"] = {
+                {"name", "binary"},
+                {"version", EIM_BINARY_PROTOCOL_VERSION},
+                {"header_size", sizeof(eim_binary_header_t)},
+            };
+        }
+
         snprintf(resp_buffer, resp_buffer_size, "%s\n", resp.dump().c_str());
 
-        state.initialized = true;
-        state.version = hello.GetInt();
+        state->initialized = true;
+        state->version = hello.GetInt();
+        state->protocol = protocol;
     }
-    else if (!state.initialized) {
+    else if (!state->initialized) {
         nlohmann::json err = {
             {"id", id},
             {"success", false},
@@ -717,7 +1297,18 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
             classify_data_shm["elements"].GetInt() :
             -1;
 
-        shm_t *shm = find_shm(SHM_TENSOR_INPUT, 0);
+        int slot = classify_data_shm["slot"].IsNumber() ?
+            classify_data_shm["slot"].GetInt() :
+            0;
+        if (slot < 0 || slot >= (int)options.shm_slots) {
+            char err_msg[256];
+            snprintf(err_msg, sizeof(err_msg), "Invalid value for 'classify_data_shm.slot', should be between 0 and %d, but got %d",
+                (int)options.shm_slots - 1, slot);
+            json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+            return;
+        }
+
+        shm_t *shm = find_shm(SHM_TENSOR_INPUT, 0, slot);
         if (!shm) {
             nlohmann::json err = {
                 {"id", id},
@@ -758,7 +1349,11 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
             debug = debug_v.GetBool();
         }
 
-        EI_IMPULSE_ERROR res = run_classifier(&signal, &result, debug);
+        EI_IMPULSE_ERROR res = use_freeform_output_slot(slot);
+        if (res == EI_IMPULSE_OK) {
+            res = run_classifier(&signal, &result, debug);
+            use_freeform_output_slot(0);
+        }
         json_send_classification_response(id, start_ms, json_parsing_ms, stdin_ms,
             res, &result, true /* use_shm */, resp_buffer, resp_buffer_size);
     }
@@ -812,7 +1407,18 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
             classify_data_continuous_shm["elements"].GetInt() :
             -1;
 
-        shm_t *shm = find_shm(SHM_TENSOR_INPUT, 0);
+        int slot = classify_data_continuous_shm["slot"].IsNumber() ?
+            classify_data_continuous_shm["slot"].GetInt() :
+            0;
+        if (slot < 0 || slot >= (int)options.shm_slots) {
+            char err_msg[256];
+            snprintf(err_msg, sizeof(err_msg), "Invalid value for 'classify_data_continuous_shm.slot', should be between 0 and %d, but got %d",
+                (int)options.shm_slots - 1, slot);
+            json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+            return;
+        }
+
+        shm_t *shm = find_shm(SHM_TENSOR_INPUT, 0, slot);
         if (!shm) {
             nlohmann::json err = {
                 {"id", id},
@@ -853,10 +1459,86 @@ void json_message_handler(rapidjson::Document &msg, char *resp_buffer, size_t re
             debug = debug_v.GetBool();
         }
 
-        EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result, debug, true);
+        EI_IMPULSE_ERROR res = use_freeform_output_slot(slot);
+        if (res == EI_IMPULSE_OK) {
+            res = run_classifier_continuous(&signal, &result, debug, true);
+            use_freeform_output_slot(0);
+        }
         json_send_classification_response(id, start_ms, json_parsing_ms, stdin_ms,
             res, &result, true /* use_shm */, resp_buffer, resp_buffer_size);
     }
+    else if (classify_batch_data.IsArray()) {
+        const size_t count = classify_batch_data.Size();
+        if (count == 0) {
+            json_send_error_response(id, "Invalid 'classify_batch', should contain at least one item", resp_buffer, resp_buffer_size);
+            return;
+        }
+
+        vector<float> input_features(count * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE);
+
+        for (rapidjson::SizeType item_ix = 0; item_ix < count; item_ix++) {
+            const rapidjson::Value& item = classify_batch_data[item_ix];
+            if (!item.IsArray() || item.Size() != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+                char err_msg[256];
+                snprintf(err_msg, sizeof(err_msg), "Invalid item %d in 'classify_batch', expected an array of %d features",
+                    (int)item_ix, (int)EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE);
+                json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+                return;
+            }
+
+            float *item_features = input_features.data() + (item_ix * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE);
+            for (rapidjson::SizeType i = 0; i < item.Size(); i++) {
+                if (!item[i].IsNumber()) {
+                    json_send_error_response(id, "Failed to parse classify_batch array, should contain all numbers", resp_buffer, resp_buffer_size);
+                    return;
+                }
+                item_features[i] = (float)item[i].GetDouble();
+            }
+        }
+
+        bool debug = false;
+        rapidjson::Value &debug_v = msg["debug"];
+        if (debug_v.IsBool()) {
+            debug = debug_v.GetBool();
+        }
+
+        classify_batch(id, input_features.data(), count, debug, start_ms, json_parsing_ms, stdin_ms,
+            resp_buffer, resp_buffer_size);
+    }
+    else if (classify_batch_data_shm.IsObject()) {
+        int count = classify_batch_data_shm["count"].IsNumber() ?
+            classify_batch_data_shm["count"].GetInt() :
+            -1;
+
+        shm_t *shm = find_shm(SHM_TENSOR_INPUT_BATCH, 0);
+        if (!shm) {
+            json_send_error_response(id, "Cannot use 'classify_batch_shm', cannot find shm batch input tensor",
+                resp_buffer, resp_buffer_size);
+            return;
+        }
+
+        if (count < 1 || count > (int)options.max_batch_size) {
+            char err_msg[256] = { 0 };
+            if (count == -1) {
+                snprintf(err_msg, sizeof(err_msg), "Missing 'count' in 'classify_batch_shm'");
+            }
+            else {
+                snprintf(err_msg, sizeof(err_msg), "Invalid value for 'classify_batch_shm.count', should be between 1 and %d, but got %d",
+                    (int)options.max_batch_size, count);
+            }
+            json_send_error_response(id, err_msg, resp_buffer, resp_buffer_size);
+            return;
+        }
+
+        bool debug = false;
+        rapidjson::Value &debug_v = msg["debug"];
+        if (debug_v.IsBool()) {
+            debug = debug_v.GetBool();
+        }
+
+        classify_batch(id, shm->features_ptr, (size_t)count, debug, start_ms, json_parsing_ms, stdin_ms,
+            resp_buffer, resp_buffer_size);
+    }
     else if (set_threshold.IsObject()) {
         if (!set_threshold.HasMember("id") || !set_threshold["id"].IsInt()) {
             nlohmann::json err = {
@@ -953,7 +1635,7 @@ int print_metadata_main() {
         rapidjson::Document::AllocatorType& allocator = msg.GetAllocator();
         msg.AddMember("id", 1, allocator);
         msg.AddMember("hello", 1, allocator);
-        json_message_handler(msg, output_buffer, 100 * 1024, 0, 0);
+        json_message_handler(&stdin_state, msg, output_buffer, 100 * 1024, 0, 0);
     }
 
     // pretty print (by first parsing, then re-printing)
@@ -969,75 +1651,405 @@ int print_metadata_main() {
     return 0;
 }
 
-int stdin_main() {
-    static char *stdin_buffer = (char *)malloc(STDIN_BUFFER_SIZE);
-    static char *response_buffer = (char *)calloc(STDIN_BUFFER_SIZE, 1);
-    if (!stdin_buffer || !response_buffer) {
-        printf("ERR: Could not allocate stdin_buffer or response_buffer\n");
-        return 1;
+/**
+ * Splits an incoming byte stream into messages, one per client. In the JSON protocol messages are
+ * found by counting braces, in the binary protocol by reading the fixed header (eim_binary_header_t)
+ * and then payload_length bytes straight into the buffer.
+ */
+typedef struct {
+    runner_protocol_t protocol;
+    char *buffer;
+    size_t buffer_size;
+    size_t buffer_ix;
+    size_t open_count;
+    size_t close_count;
+    eim_binary_header_t binary_header;
+    size_t binary_header_ix;
+    uint64_t read_start_ms;
+} message_framer_t;
+
+typedef enum {
+    FRAMER_NEED_MORE = 0,
+    FRAMER_MESSAGE_COMPLETE = 1,
+    FRAMER_OVERFLOW = -1,
+    FRAMER_INVALID_HEADER = -2,
+} framer_status_t;
+
+static int framer_init(message_framer_t *framer, size_t buffer_size) {
+    framer->protocol = PROTOCOL_JSON;
+    framer->buffer = (char *)malloc(buffer_size);
+    framer->buffer_size = buffer_size;
+    framer->buffer_ix = 0;
+    framer->open_count = 0;
+    framer->close_count = 0;
+    framer->binary_header_ix = 0;
+    framer->read_start_ms = 0;
+    return framer->buffer ? 0 : -1;
+}
+
+static void framer_free(message_framer_t *framer) {
+    free(framer->buffer);
+    framer->buffer = nullptr;
+}
+
+static void framer_reset(message_framer_t *framer) {
+    // no need to clear the buffer, every message is NUL terminated by the framer
+    framer->buffer_ix = 0;
+    framer->close_count = 0;
+    framer->open_count = 0;
+    framer->binary_header_ix = 0;
+    framer->read_start_ms = 0;
+}
+
+/**
+ * Returns the offset of the first '{' or '}' in data (or len if there's none). This is the hot loop
+ * for large JSON messages, so compare 16 bytes at a time where we can.
+ */
+static size_t find_next_brace(const char *data, size_t len) {
+    size_t ix = 0;
+#if defined(__SSE2__)
+    const __m128i open_v = _mm_set1_epi8('{');
+    const __m128i close_v = _mm_set1_epi8('}');
+    for (; ix + 16 <= len; ix += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + ix));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, open_v), _mm_cmpeq_epi8(chunk, close_v)));
+        if (mask != 0) {
+            return ix + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__aarch64__)
+    const uint8x16_t open_v = vdupq_n_u8('{');
+    const uint8x16_t close_v = vdupq_n_u8('}');
+    for (; ix + 16 <= len; ix += 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *)(data + ix));
+        uint8x16_t match = vorrq_u8(vceqq_u8(chunk, open_v), vceqq_u8(chunk, close_v));
+        if (vmaxvq_u8(match) != 0) {
+            break; // the scalar loop below finds the exact position
+        }
+    }
+#endif
+    for (; ix < len; ix++) {
+        if (data[ix] == '{' || data[ix] == '}') {
+            return ix;
+        }
     }
-    static size_t stdin_buffer_ix = 0;
-    static size_t open_count = 0;
-    static size_t close_count = 0;
-    uint64_t read_from_stdin_start = 0;
+    return len;
+}
 
-    char c;
+static framer_status_t framer_push_json(message_framer_t *framer, const char *data, size_t len, size_t *consumed) {
+    size_t ix = 0;
 
-    while ((c = getchar()) && c != EOF) {
-        stdin_buffer[stdin_buffer_ix++] = c;
+    while (ix < len) {
+        size_t brace_ix = ix + find_next_brace(data + ix, len - ix);
 
-        if (stdin_buffer_ix > STDIN_BUFFER_SIZE - 1) {
-            printf("Invalid message, received more than %d bytes, and no valid JSON message detected\n",
-                STDIN_BUFFER_SIZE);
-            return 1;
+        // outside of a message, anything up to the next '{' is ignored
+        if (framer->open_count == 0) {
+            if (brace_ix == len) {
+                break;
+            }
+            if (data[brace_ix] == '}') {
+                ix = brace_ix + 1;
+                continue;
+            }
+            ix = brace_ix;
+            framer->read_start_ms = ei_read_timer_ms();
         }
 
-        if (c == '{') {
-            open_count++;
+        size_t copy_len = (brace_ix == len ? len : brace_ix + 1) - ix;
+        // keep one byte for the terminator
+        if (framer->buffer_ix + copy_len > framer->buffer_size - 1) {
+            *consumed = ix;
+            return FRAMER_OVERFLOW;
         }
-        else if (c == '}') {
-            close_count++;
-            if (close_count == open_count) {
-                uint64_t read_from_stdin = ei_read_timer_ms() - read_from_stdin_start;
-                try {
-                    auto now = ei_read_timer_ms();
+        memcpy(framer->buffer + framer->buffer_ix, data + ix, copy_len);
+        framer->buffer_ix += copy_len;
+        ix += copy_len;
 
-                    rapidjson::Document msg(&rapidjson_allocator);
-                    msg.Parse(stdin_buffer);
+        if (brace_ix == len) {
+            break;
+        }
 
-                    // auto msg = json::parse(stdin_buffer);
-                    auto json_parsing_ms = ei_read_timer_ms() - now;
-                    json_message_handler(msg, response_buffer, STDIN_BUFFER_SIZE, json_parsing_ms, read_from_stdin);
-                    printf("%s", response_buffer);
+        if (data[brace_ix] == '{') {
+            framer->open_count++;
+        }
+        else {
+            framer->close_count++;
+            if (framer->close_count == framer->open_count) {
+                framer->buffer[framer->buffer_ix] = '\0';
+                *consumed = ix;
+                return FRAMER_MESSAGE_COMPLETE;
+            }
+        }
+    }
 
-                    rapidjson_allocator.Clear();
-                }
-                catch (const std::exception& e) {
-                    nlohmann::json err = {
-                        {"error", e.what()},
-                    };
-                    printf("%s\n", err.dump().c_str());
-                }
+    *consumed = len;
+    return FRAMER_NEED_MORE;
+}
+
+static framer_status_t framer_push_binary(message_framer_t *framer, const char *data, size_t len, size_t *consumed) {
+    *consumed = 0;
+
+    if (framer->binary_header_ix < sizeof(eim_binary_header_t)) {
+        if (framer->binary_header_ix == 0) {
+            framer->read_start_ms = ei_read_timer_ms();
+        }
+
+        size_t header_bytes = std::min(len, sizeof(eim_binary_header_t) - framer->binary_header_ix);
+        memcpy((uint8_t *)&framer->binary_header + framer->binary_header_ix, data, header_bytes);
+        framer->binary_header_ix += header_bytes;
+        *consumed += header_bytes;
+
+        if (framer->binary_header_ix < sizeof(eim_binary_header_t)) {
+            return FRAMER_NEED_MORE;
+        }
+        if (framer->binary_header.magic != EIM_BINARY_MAGIC) {
+            return FRAMER_INVALID_HEADER;
+        }
+        // keep one byte for the terminator of JSON payloads
+        if (framer->binary_header.payload_length > framer->buffer_size - 1) {
+            return FRAMER_OVERFLOW;
+        }
+    }
+
+    size_t payload_bytes = std::min(len - *consumed, framer->binary_header.payload_length - framer->buffer_ix);
+    memcpy(framer->buffer + framer->buffer_ix, data + *consumed, payload_bytes);
+    framer->buffer_ix += payload_bytes;
+    *consumed += payload_bytes;
+
+    if (framer->buffer_ix < framer->binary_header.payload_length) {
+        return FRAMER_NEED_MORE;
+    }
+
+    framer->buffer[framer->buffer_ix] = '\0';
+    return FRAMER_MESSAGE_COMPLETE;
+}
+
+/**
+ * Feed (part of) a chunk of incoming bytes to the framer. Stops after the first complete message
+ * (or error), `consumed` is set to the number of bytes that were used from `data`.
+ */
+static framer_status_t framer_feed(message_framer_t *framer, const char *data, size_t len, size_t *consumed) {
+    if (framer->protocol == PROTOCOL_BINARY) {
+        return framer_push_binary(framer, data, len, consumed);
+    }
+    return framer_push_json(framer, data, len, consumed);
+}
+
+/**
+ * Handle a binary message (see inc/eim_binary_protocol.h). The response (header + JSON payload)
+ * is written into resp_buffer, returns the number of bytes in the response.
+ */
+static size_t binary_message_handler(runner_state_t *state, const eim_binary_header_t *header, char *payload,
+                                     char *resp_buffer, size_t resp_buffer_size, uint64_t stdin_ms)
+{
+    uint64_t start_ms = ei_read_timer_ms();
+
+    eim_binary_header_t *resp_header = (eim_binary_header_t *)resp_buffer;
+    char *resp_payload = resp_buffer + sizeof(eim_binary_header_t);
+    size_t resp_payload_size = resp_buffer_size - sizeof(eim_binary_header_t);
+    bool debug = header->flags & EIM_BINARY_FLAG_DEBUG;
+
+    if (header->message_type == EIM_BINARY_MSG_JSON) {
+        auto now = ei_read_timer_ms();
+        rapidjson::Document msg(&rapidjson_allocator);
+        msg.Parse(payload);
+        auto json_parsing_ms = ei_read_timer_ms() - now;
+
+        if (msg.HasParseError() || !msg.IsObject()) {
+            nlohmann::json err = {
+                {"id", header->id},
+                {"success", false},
+                {"error", "Failed to parse JSON payload"},
+            };
+            snprintf(resp_payload, resp_payload_size, "%s\n", err.dump().c_str());
+        }
+        else {
+            json_message_handler(state, msg, resp_payload, resp_payload_size, json_parsing_ms, stdin_ms);
+        }
+        rapidjson_allocator.Clear();
+    }
+    else if (header->message_type == EIM_BINARY_MSG_CLASSIFY || header->message_type == EIM_BINARY_MSG_CLASSIFY_CONTINUOUS) {
+        const bool continuous = header->message_type == EIM_BINARY_MSG_CLASSIFY_CONTINUOUS;
+        const size_t expected_elements = continuous ? EI_CLASSIFIER_SLICE_SIZE : EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+
+        char err_msg[256] = { 0 };
+        if (header->dtype != EIM_BINARY_DTYPE_FLOAT32) {
+            snprintf(err_msg, sizeof(err_msg), "Invalid dtype %d, only float32 (%d) is supported",
+                (int)header->dtype, (int)EIM_BINARY_DTYPE_FLOAT32);
+        }
+        else if (header->payload_length != expected_elements * sizeof(float)) {
+            snprintf(err_msg, sizeof(err_msg), "Invalid payload length, expected %d bytes (%d features) but got %d",
+                (int)(expected_elements * sizeof(float)), (int)expected_elements, (int)header->payload_length);
+        }
+
+        if (strlen(err_msg) > 0) {
+            nlohmann::json err = {
+                {"id", header->id},
+                {"success", false},
+                {"error", err_msg},
+            };
+            snprintf(resp_payload, resp_payload_size, "%s\n", err.dump().c_str());
+        }
+        else {
+            ei_impulse_result_t result;
+            memset(&result, 0, sizeof(ei_impulse_result_t));
+            signal_t signal;
+            numpy::signal_from_buffer((float *)payload, expected_elements, &signal);
+
+            std::lock_guard<std::mutex> lock(default_classifier_mutex);
+
+            EI_IMPULSE_ERROR res = continuous ?
+                run_classifier_continuous(&signal, &result, debug, true) :
+                run_classifier(&signal, &result, debug);
+            json_send_classification_response(header->id, start_ms, 0, stdin_ms,
+                res, &result, false /* use_shm */, resp_payload, resp_payload_size);
+        }
+    }
+    else {
+        char err_msg[128];
+        snprintf(err_msg, sizeof(err_msg), "Invalid message_type %d", (int)header->message_type);
+        nlohmann::json err = {
+            {"id", header->id},
+            {"success", false},
+            {"error", err_msg},
+        };
+        snprintf(resp_payload, resp_payload_size, "%s\n", err.dump().c_str());
+    }
+
+    size_t payload_length = strlen(resp_payload);
+    if (payload_length > 0 && resp_payload[payload_length - 1] == '\n') {
+        resp_payload[--payload_length] = '\0';
+    }
+
+    resp_header->magic = EIM_BINARY_MAGIC;
+    resp_header->id = header->id;
+    resp_header->message_type = EIM_BINARY_MSG_RESPONSE;
+    resp_header->dtype = EIM_BINARY_DTYPE_NONE;
+    resp_header->flags = 0;
+    resp_header->payload_length = (uint32_t)payload_length;
+
+    return sizeof(eim_binary_header_t) + payload_length;
+}
+
+/**
+ * Parse the message that's in the framer, and handle it. Always writes a response into
+ * response_buffer, and returns the number of bytes to send back (JSON protocol: the newline
+ * terminated response plus the NUL terminator; binary protocol: header and payload).
+ * Resets the framer afterwards (and switches it to the protocol negotiated in 'hello').
+ */
+static size_t handle_framed_message(runner_state_t *state, message_framer_t *framer, char *response_buffer, size_t response_buffer_size) {
+    uint64_t read_from_stdin = ei_read_timer_ms() - framer->read_start_ms;
+    size_t response_length;
+
+    if (framer->protocol == PROTOCOL_BINARY) {
+        response_length = binary_message_handler(state, &framer->binary_header, framer->buffer,
+            response_buffer, response_buffer_size, read_from_stdin);
+    }
+    else {
+        try {
+            auto now = ei_read_timer_ms();
+
+            // parse in place, strings in the document point into the framer buffer (valid until framer_reset)
+            rapidjson::Document msg(&rapidjson_allocator);
+            msg.ParseInsitu(framer->buffer);
 
-                stdin_buffer_ix = 0;
-                memset(stdin_buffer, 0, STDIN_BUFFER_SIZE);
-                close_count = 0;
-                open_count = 0;
+            auto json_parsing_ms = ei_read_timer_ms() - now;
+            if (msg.HasParseError() || !msg.IsObject()) {
+                nlohmann::json err = {
+                    {"success", false},
+                    {"error", "Failed to parse JSON message"},
+                };
+                snprintf(response_buffer, response_buffer_size, "%s\n", err.dump().c_str());
+            }
+            else {
+                json_message_handler(state, msg, response_buffer, response_buffer_size, json_parsing_ms, read_from_stdin);
             }
+
+            rapidjson_allocator.Clear();
+        }
+        catch (const std::exception& e) {
+            nlohmann::json err = {
+                {"error", e.what()},
+            };
+            snprintf(response_buffer, response_buffer_size, "%s\n", err.dump().c_str());
         }
-        else if (open_count == 0) {
-            stdin_buffer_ix--;
-            read_from_stdin_start = 0;
+        response_length = strlen(response_buffer) + 1;
+    }
+
+    framer_reset(framer);
+    framer->protocol = state->protocol;
+
+    return response_length;
+}
+
+int stdin_main() {
+    const size_t read_chunk_size = 1 * 1024 * 1024;
+    static char *read_buffer = (char *)malloc(read_chunk_size);
+    static char *response_buffer = (char *)calloc(STDIN_BUFFER_SIZE, 1);
+    static message_framer_t framer;
+    if (framer_init(&framer, STDIN_BUFFER_SIZE) != 0 || !response_buffer || !read_buffer) {
+        printf("ERR: Could not allocate stdin_buffer or response_buffer\n");
+        return 1;
+    }
+
+    ssize_t len;
+
+    while ((len = read(STDIN_FILENO, read_buffer, read_chunk_size)) != 0) {
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            printf("ERR: Failed to read from stdin (%d)\n", errno);
+            return 1;
         }
 
-        if (open_count == 1 && read_from_stdin_start == 0) {
-            read_from_stdin_start = ei_read_timer_ms();
+        size_t offset = 0;
+        while (offset < (size_t)len) {
+            size_t consumed;
+            framer_status_t status = framer_feed(&framer, read_buffer + offset, len - offset, &consumed);
+            offset += consumed;
+
+            if (status == FRAMER_INVALID_HEADER) {
+                printf("Invalid message, binary header does not start with the expected magic\n");
+                return 1;
+            }
+            if (status == FRAMER_OVERFLOW) {
+                printf("Invalid message, received more than %d bytes, and no valid JSON message detected\n",
+                    STDIN_BUFFER_SIZE);
+                return 1;
+            }
+            if (status != FRAMER_MESSAGE_COMPLETE) {
+                continue;
+            }
+
+            bool binary = framer.protocol == PROTOCOL_BINARY;
+            size_t response_length = handle_framed_message(&stdin_state, &framer, response_buffer, STDIN_BUFFER_SIZE);
+            if (!binary) {
+                response_length--; // no NUL terminator on stdout
+            }
+            // stdout is fully buffered in stdin mode, so this is a single write
+            fwrite(response_buffer, 1, response_length, stdout);
+            fflush(stdout);
         }
     }
 
     return 0;
 }
 
+// a client connected over the UNIX socket, every connection has its own framing and hello state
+typedef struct {
+    int fd;
+    runner_state_t state;
+    message_framer_t framer;
+} eim_connection_t;
+
+static void close_connection(event_loop_t *loop, std::map<int, eim_connection_t *> &connections, eim_connection_t *conn) {
+    event_loop_remove(loop, conn->fd);
+    close(conn->fd);
+    framer_free(&conn->framer);
+    connections.erase(conn->fd);
+    printf("Disconnected (fd=%d, %d clients connected)\n", conn->fd, (int)connections.size());
+    delete conn;
+}
+
 int socket_main(char *socket_path) {
     int fd = socket(PF_UNIX, SOCK_STREAM, 0);
     if (fd < 0) {
@@ -1061,91 +2073,119 @@ int socket_main(char *socket_path) {
         return 1;
     }
 
-    // @todo: should we put this in a while(1) and move the accept() to another thread so you can have multiple listeners?
-    // probably not
-    printf("Waiting for connection on %s...\n", socket_path);
-    int connfd = accept(fd, (struct sockaddr*)NULL, NULL);
-    printf("Connected\n");
+    // a client that disconnects while we write its response should not take the runner down
+    signal(SIGPIPE, SIG_IGN);
+
+    // non-blocking, so we can drain all pending connections on every wakeup
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    event_loop_t loop;
+    if (event_loop_init(&loop) != 0 || event_loop_add(&loop, fd, true, false) != 0) {
+        printf("ERR: Failed to set up event loop for UNIX socket (%d)\n", errno);
+        return 1;
+    }
 
     char *socket_buffer = (char *)calloc(STDIN_BUFFER_SIZE, sizeof(char));
-    char *stdin_buffer = (char *)calloc(STDIN_BUFFER_SIZE, sizeof(char));
     char *response_buffer = (char *)calloc(STDIN_BUFFER_SIZE, sizeof(char));
-    if (!socket_buffer || !stdin_buffer || !response_buffer) {
+    if (!socket_buffer || !response_buffer) {
         printf("ERR: Could not allocate buffers\n");
         return 1;
     }
-    static size_t stdin_buffer_ix = 0;
-    static size_t open_count = 0;
-    static size_t close_count = 0;
-    uint64_t read_from_stdin_start = 0;
 
-    int len;
-    while ((len = read(connfd, socket_buffer, STDIN_BUFFER_SIZE)) > 0) {
-        for (int ix = 0; ix < len; ix++) {
-            char c = socket_buffer[ix];
+    std::map<int, eim_connection_t *> connections;
 
-            stdin_buffer[stdin_buffer_ix++] = c;
-
-            if (stdin_buffer_ix > STDIN_BUFFER_SIZE - 1) {
-                printf("Invalid message, received more than %d bytes, and no valid JSON message detected\n",
-                    STDIN_BUFFER_SIZE);
-                return 1;
-            }
+    printf("Waiting for connection on %s...\n", socket_path);
 
-            if (c == '{') {
-                open_count++;
-            }
-            else if (c == '}') {
-                close_count++;
-                if (close_count == open_count) {
-                    uint64_t read_from_stdin = ei_read_timer_ms() - read_from_stdin_start;
-                    try {
-                        // printf("Incoming message: %s\n", stdin_buffer);
-                        auto now = ei_read_timer_ms();
-                        rapidjson::Document msg(&rapidjson_allocator);
-                        msg.Parse(stdin_buffer);
-                        // auto msg = json::parse(stdin_buffer);
-                        auto json_parsing_ms = ei_read_timer_ms() - now;
-                        json_message_handler(msg, response_buffer, STDIN_BUFFER_SIZE, json_parsing_ms, read_from_stdin);
-                        // printf("Sending back: %s\n", response_buffer);
-                        int ret = write(connfd, response_buffer, strlen(response_buffer) + 1);
-                        if (ret < 0) {
-                            printf("ERR: Failed to send message back (%d)\n", ret);
-                        }
-                        rapidjson_allocator.Clear();
-                    }
-                    catch (const std::exception& e) {
-                        nlohmann::json err = {
-                            {"error", e.what()},
-                        };
-                        snprintf(response_buffer, STDIN_BUFFER_SIZE, "%s\n", err.dump().c_str());
+    const int max_events = 64;
+    event_loop_event_t events[max_events];
 
-                        // printf("Sending back: %s\n", response_buffer);
+    while (1) {
+        int event_count = event_loop_wait(&loop, events, max_events, -1);
+        if (event_count < 0) {
+            printf("ERR: Waiting for events on UNIX socket failed (%d)\n", errno);
+            break;
+        }
 
-                        int ret = write(connfd, response_buffer, strlen(response_buffer) + 1);
-                        if (ret < 0) {
-                            printf("ERR: Failed to send message back (%d)\n", ret);
-                        }
+        for (int ev_ix = 0; ev_ix < event_count; ev_ix++) {
+            const event_loop_event_t& ev = events[ev_ix];
+
+            // new connection(s)
+            if (ev.fd == fd) {
+                int connfd;
+                while ((connfd = accept(fd, (struct sockaddr*)NULL, NULL)) >= 0) {
+                    eim_connection_t *conn = new eim_connection_t();
+                    conn->fd = connfd;
+                    conn->state = { 0 };
+                    if (framer_init(&conn->framer, STDIN_BUFFER_SIZE) != 0 ||
+                            event_loop_add(&loop, connfd, true, false) != 0) {
+                        printf("ERR: Could not set up connection (fd=%d)\n", connfd);
+                        framer_free(&conn->framer);
+                        close(connfd);
+                        delete conn;
+                        continue;
                     }
+                    connections[connfd] = conn;
+                    printf("Connected (fd=%d, %d clients connected)\n", connfd, (int)connections.size());
+                }
+                continue;
+            }
 
-                    stdin_buffer_ix = 0;
-                    memset(stdin_buffer, 0, STDIN_BUFFER_SIZE);
-                    close_count = 0;
-                    open_count = 0;
+            auto conn_it = connections.find(ev.fd);
+            if (conn_it == connections.end()) {
+                continue;
+            }
+            eim_connection_t *conn = conn_it->second;
+
+            if (!ev.readable) {
+                if (ev.hangup) {
+                    close_connection(&loop, connections, conn);
                 }
+                continue;
             }
-            else if (open_count == 0) {
-                stdin_buffer_ix--;
-                read_from_stdin_start = 0;
+
+            int len = read(conn->fd, socket_buffer, STDIN_BUFFER_SIZE);
+            if (len <= 0) {
+                close_connection(&loop, connections, conn);
+                continue;
             }
 
-            if (open_count == 1 && read_from_stdin_start == 0) {
-                read_from_stdin_start = ei_read_timer_ms();
+            size_t offset = 0;
+            while (offset < (size_t)len) {
+                size_t consumed;
+                framer_status_t status = framer_feed(&conn->framer, socket_buffer + offset, len - offset, &consumed);
+                offset += consumed;
+
+                if (status == FRAMER_OVERFLOW || status == FRAMER_INVALID_HEADER) {
+                    if (status == FRAMER_OVERFLOW) {
+                        printf("Invalid message, received more than %d bytes, and no valid JSON message detected\n",
+                            STDIN_BUFFER_SIZE);
+                    }
+                    else {
+                        printf("Invalid message, binary header does not start with the expected magic\n");
+                    }
+                    close_connection(&loop, connections, conn);
+                    break;
+                }
+                if (status != FRAMER_MESSAGE_COMPLETE) {
+                    continue;
+                }
+
+                size_t response_length = handle_framed_message(&conn->state, &conn->framer, response_buffer, STDIN_BUFFER_SIZE);
+
+                int ret = write(conn->fd, response_buffer, response_length);
+                if (ret < 0) {
+                    printf("ERR: Failed to send message back (%d)\n", ret);
+                }
             }
         }
     }
 
-    close(connfd);
+    for (auto it : connections) {
+        close(it.first);
+        framer_free(&it.second->framer);
+        delete it.second;
+    }
+    event_loop_deinit(&loop);
 
     return close(fd);
 }
@@ -1160,15 +2200,76 @@ string trim(const string& str) {
     return str.substr(first, (last - first + 1));
 }
 
+static bool parse_size_option(const char *name, const char *value, size_t *out) {
+    char *end = nullptr;
+    long v = value ? strtol(value, &end, 10) : -1;
+    if (!value || *end != '\0' || v < 0) {
+        printf("ERR: Invalid value for %s, should be a non-negative number\n", name);
+        return false;
+    }
+    *out = (size_t)v;
+    return true;
+}
+
+/**
+ * Parse the options that follow the mode (argv[1]) into `options`. Returns 0 when OK.
+ */
+static int parse_options(int argc, char **argv) {
+    for (int ix = 2; ix < argc; ix++) {
+        const char *arg = argv[ix];
+        const char *value = ix + 1 < argc ? argv[ix + 1] : nullptr;
+
+        if (strcmp(arg, "--threads") == 0) {
+            if (!parse_size_option(arg, value, &options.worker_threads)) return 1;
+            ix++;
+        }
+        else if (strcmp(arg, "--max-batch-size") == 0) {
+            if (!parse_size_option(arg, value, &options.max_batch_size)) return 1;
+            ix++;
+        }
+        else if (strcmp(arg, "--shm-queue-size") == 0) {
+            if (!parse_size_option(arg, value, &options.shm_queue_size)) return 1;
+            ix++;
+        }
+        else if (strcmp(arg, "--shm-slots") == 0) {
+            if (!parse_size_option(arg, value, &options.shm_slots)) return 1;
+            if (options.shm_slots < 1 || options.shm_slots > 256) {
+                printf("ERR: Invalid value for --shm-slots, should be between 1 and 256\n");
+                return 1;
+            }
+            ix++;
+        }
+        else {
+            printf("ERR: Unknown option '%s'\n", arg);
+            printf("Options: --threads N (worker threads for batches, default: one per core), "
+                "--max-batch-size N (frames in the batch shm input, default: 16), "
+                "--shm-slots N (shm input/output slots, default: 1), "
+                "--shm-queue-size N (entries in the shm command queue, 0 to disable, default: 16)\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static void on_signal(int sig){
     cleanup_all_shm();
     _exit(128 + sig);
 }
 
 int main(int argc, char **argv) {
-    setvbuf(stdout, NULL, _IONBF, 0);
+    // in stdin mode stdout carries the responses, buffer those fully (and flush once per response)
+    if (argc >= 2 && strcmp(argv[1], "stdin") == 0) {
+        setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+    }
+    else {
+        setvbuf(stdout, NULL, _IONBF, 0);
+    }
 
     atexit(cleanup_all_shm);
+#if defined(__linux__)
+    // registered after cleanup_all_shm, so it runs before it (the thread uses the queue segment)
+    atexit(stop_shm_queue);
+#endif
     struct sigaction sa{};
     sa.sa_handler = on_signal;
     sigemptyset(&sa.sa_mask);
@@ -1181,7 +2282,11 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    state.initialized = false;
+    stdin_state.initialized = false;
+
+    if (parse_options(argc, argv) != 0) {
+        return 1;
+    }
 
     if (strcmp(argv[1], "--print-info") == 0) {
         printf("Edge Impulse Linux impulse runner - printing model metadata\n");
@@ -1189,6 +2294,7 @@ int main(int argc, char **argv) {
     }
     if (strcmp(argv[1], "stdin") == 0) {
         printf("Edge Impulse Linux impulse runner - listening for JSON messages on stdin\n");
+        fflush(stdout);
         return stdin_main();
     }
 #if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_AKIDA)